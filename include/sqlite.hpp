@@ -2,66 +2,809 @@
 #define __SQLITE_HPP__
 
 #include <string>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+#include <string_view>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <ranges>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <exception>
+#include <coroutine>
+
+struct sqlite3;
 
 namespace sqlite {
+    // Bounded LRU cache of prepared statements keyed by SQL text.
+    // Statements are prepared with SQLITE_PREPARE_PERSISTENT and are reset
+    // and have their bindings cleared when they are checked back in.
+    // Checking out SQL whose cached statement is already checked out (e.g. a nested exec of
+    // the same text during a STREAMING scan) prepares a separate statement, counted as a
+    // miss, which is finalized on check-in; the cached statement keeps its slot.
+    class StatementCache {
+    public:
+        // Capacity of the cache of a Database(path).
+        static constexpr size_t DEFAULT_CAPACITY = 64;
+
+        struct Stats {
+            size_t hits;
+            size_t misses;
+            size_t evictions;
+        };
+
+        size_t size() const;
+        size_t capacity() const;
+        // Evicts least recently used statements down to capacity. With a capacity of 0
+        // nothing is cached: every checkout prepares and every check-in finalizes.
+        void resize(const size_t capacity);
+        // Finalizes every statement that is not checked out and zeroes stats().
+        void clear();
+
+        const Stats &stats() const;
+    };
+
+    // Opt-in LRU cache of BUFFERED results of read-only statements, looked up by SQL text and a
+    // hash of the bound values. Entries keep a copy of the bound values, which are compared on
+    // a hash match so colliding hashes never return another query's rows. The cache is
+    // bounded by the memory held by cached rows and values. Disabled while its
+    // capacity is 0. Executing any statement on the same connection for which
+    // sqlite3_stmt_readonly() is false invalidates it, which also covers truncating DELETEs,
+    // REPLACE conflicts, WITHOUT ROWID tables and DDL that the update hook misses. Writes
+    // from other connections are caught by a PRAGMA data_version check before each lookup.
+    // That check only covers the main database, and some functions return different rows for
+    // the same input, so a statement is never cached when the authorizer sees it, at prepare
+    // time, reading a table outside main and temp or calling random(), randomblob(), a date
+    // and time function, changes(), total_changes(), last_insert_rowid() or an
+    // application-defined function. Statement::set_cacheable(false) opts out any other statement.
+    class ResultCache {
+    public:
+        struct Stats {
+            size_t hits;
+            size_t misses;
+            size_t evictions;
+            size_t invalidations;
+        };
+
+        // Bytes held by cached rows.
+        size_t memory() const;
+        size_t capacity() const;
+        void resize(const size_t capacity);
+        void clear();
+
+        const Stats &stats() const;
+    };
+
+    typedef std::chrono::steady_clock::time_point Deadline;
+
+    // How a connection waits when another connection holds the lock (SQLITE_BUSY).
+    class BusyStrategy {
+    public:
+        // Returns SQLITE_BUSY immediately.
+        static BusyStrategy fail();
+        // Retries until timeout like sqlite3_busy_timeout.
+        static BusyStrategy timeout(const std::chrono::milliseconds timeout);
+        // Sleeps initial_delay, multiplied by two after every attempt up to max_delay, each
+        // sleep randomized by +/- jitter (0..1) of itself, until timeout has elapsed.
+        static BusyStrategy backoff(const std::chrono::microseconds initial_delay, const std::chrono::microseconds max_delay,
+                                    const std::chrono::milliseconds timeout, const double jitter);
+    };
+
+    // Latency histogram with power-of-two microsecond buckets.
+    class Histogram {
+    public:
+        size_t count() const;
+        std::chrono::nanoseconds total() const;
+        // p is a fraction in [0, 1] (0.99 for p99); values outside are clamped. Returns the
+        // upper bound of the bucket holding the p-quantile sample, or zero when count() == 0.
+        std::chrono::nanoseconds percentile(const double p) const;
+        // buckets()[0] counts samples in [0, 1) microseconds and buckets()[i] for i > 0
+        // counts samples in [2^(i-1), 2^i) microseconds.
+        const std::vector<size_t> &buckets() const;
+    };
+
     class Database {
     public:
         Database(const std::string &path);
+        Database(const std::string &path, const size_t statement_cache_capacity);
+        ~Database();
+
+        Database(const Database &) = delete;
+        Database &operator=(const Database &) = delete;
+        Database(Database &&other) noexcept;
+        Database &operator=(Database &&other) noexcept;
+
+        StatementCache &statement_cache();
+        const StatementCache &statement_cache() const;
+
+        ResultCache &result_cache();
+        const ResultCache &result_cache() const;
+
+        // Number of executions stopped because their deadline expired.
+        // Deadlines, statement timeouts and the yielding of query() share the connection's
+        // single sqlite3_progress_handler, which runs every deadline check and yield counter
+        // that is active. Installing another progress handler on the connection disables them.
+        size_t deadlines_fired() const;
+
+        void set_busy_strategy(const BusyStrategy &strategy);
+        // Time spent waiting on locks, recorded per busy episode.
+        const Histogram &busy_waits() const;
     };
 
+    // Trivially copyable status: an error code plus either a pointer to a static message
+    // or a copy of the message the connection reported. An Error never refers to a
+    // connection, so it stays valid after the connection reports other errors, is closed,
+    // or is used by another thread.
     class Error {
     public:
-        Error(const int code, const std::string &msg);
-        const int code() const;
-        const std::string &msg() const;
-        operator bool() const;
+        static constexpr size_t DETAIL_SIZE = 96;
+
+        constexpr explicit Error(const int code) noexcept : code_(code), msg_(nullptr), detail_() {}
+        constexpr Error(const int code, const char *msg) noexcept : code_(code), msg_(msg), detail_() {}
+        // Copies sqlite3_errmsg(db) (e.g. "no such table: X") at construction, truncated to
+        // DETAIL_SIZE - 1 bytes. Only failing calls pay for the copy.
+        Error(const int code, sqlite3 *db) noexcept;
+
+        constexpr int code() const noexcept { return code_; }
+        // Builds the message text only when asked: the static message, else the copied
+        // connection message, else sqlite3_errstr(code()).
+        std::string msg() const;
+        constexpr operator bool() const noexcept { return code_ != 0; }
+
+    private:
+        int code_;
+        const char *msg_;
+        char detail_[DETAIL_SIZE];
+    };
+
+    // Returned when a deadline or timeout expires. The code is outside SQLite's result code range.
+    inline constexpr Error TIMEOUT(0x10000, "Deadline exceeded");
+
+    // Carries an Error through channels that can only transport exceptions, such as std::future.
+    // The Error holds a copy of its message, so it stays readable after the connection that
+    // reported it is closed.
+    class Exception : public std::exception {
+    public:
+        explicit Exception(const Error &err);
+
+        const Error &error() const noexcept;
+        const char *what() const noexcept override;
     };
 
     class Statement {
     public:
+        // Checks the prepared statement out of the database statement cache.
         Statement(Database &db, const std::string &sql);
+        // Checks the prepared statement back in to the database statement cache.
+        ~Statement();
+
+        Statement(const Statement &) = delete;
+        Statement &operator=(const Statement &) = delete;
+        Statement(Statement &&other) noexcept;
+        Statement &operator=(Statement &&other) noexcept;
 
         template <typename T>
         const Error &bind(const size_t index, const T &value);
+
+        // Rewinds the statement so it can be executed again from its first row, for example
+        // part-way through STREAMING results, which end. Bindings are kept.
+        const Error &reset();
+        const Error &clear_bindings();
+
+        // Limits every following execution of the statement. Enforced by the connection's
+        // progress handler, which checks the steady clock every few hundred VM instructions;
+        // zero disables it.
+        void set_timeout(const std::chrono::nanoseconds timeout);
+
+        // Lets the database result cache keep this statement's results; true by default.
+        void set_cacheable(const bool cacheable);
+
+        // Binds the fields of each tuple or aggregate in rows in order, steps and resets.
+        // Rows are committed in one Transaction every batch_size rows (0 means all rows).
+        // When a row fails, its batch is rolled back and its error returned; batches before it
+        // stay committed and no later row is run. rows_committed is set to the number of
+        // leading rows that are committed, so a feed can resume from that row.
+        template <std::ranges::input_range Range>
+        const Error exec_batch(Range &&rows, const size_t batch_size = 0);
+        template <std::ranges::input_range Range>
+        const Error exec_batch(Range &&rows, const size_t batch_size, size_t &rows_committed);
+    };
+
+    enum class TransactionLevel {
+        DEFERRED,
+        IMMEDIATE,
+        EXCLUSIVE
     };
 
+    // The outermost Transaction on a connection runs BEGIN <level>. A Transaction opened
+    // while another one is active becomes a SAVEPOINT: commit() releases it and rolling
+    // back undoes only its own changes, leaving the enclosing transaction open. The level
+    // of a nested Transaction is ignored.
     class Transaction {
     public:
-        Transaction(Database &db);
+        Transaction(Database &db, const TransactionLevel level = TransactionLevel::DEFERRED);
+        // Rolls the transaction back unless it was committed.
+        ~Transaction();
+
+        Transaction(const Transaction &) = delete;
+        Transaction &operator=(const Transaction &) = delete;
+        Transaction(Transaction &&other) noexcept;
+        Transaction &operator=(Transaction &&other) noexcept;
         const Error &commit();
+        const Error &rollback();
+
+        bool nested() const;
+    };
+
+    // Point-in-time state of a WAL-mode database captured with sqlite3_snapshot_get.
+    // Requires SQLite built with SQLITE_ENABLE_SNAPSHOT. A snapshot stays usable until a
+    // checkpoint overwrites the WAL frames it refers to.
+    class Snapshot {
+    public:
+        explicit Snapshot(Database &db);
+        ~Snapshot();
+
+        Snapshot(const Snapshot &) = delete;
+        Snapshot &operator=(const Snapshot &) = delete;
+        Snapshot(Snapshot &&other) noexcept;
+        Snapshot &operator=(Snapshot &&other) noexcept;
+
+        const Error &error() const;
+    };
+
+    // Read transaction on db opened at snapshot with sqlite3_snapshot_open, so queries run
+    // on any number of connections inside such transactions see the same database state.
+    // Ends the read transaction on destruction.
+    class SnapshotTransaction {
+    public:
+        SnapshotTransaction(Database &db, const Snapshot &snapshot);
+        ~SnapshotTransaction();
+
+        SnapshotTransaction(const SnapshotTransaction &) = delete;
+        SnapshotTransaction &operator=(const SnapshotTransaction &) = delete;
+        SnapshotTransaction(SnapshotTransaction &&other) noexcept;
+        SnapshotTransaction &operator=(SnapshotTransaction &&other) noexcept;
+
+        const Error &error() const;
+    };
+
+    // Return type of Results::get<T>. Owned values are returned by const reference;
+    // std::string_view and std::span<const std::byte> are returned by value as views.
+    // What they point at, and for how long, depends on Results::Mode:
+    // - STREAMING: SQLite's column memory, without copying; valid until the next step.
+    // - BUFFERED: the row copy held by the Results; valid for the lifetime of the Results.
+    // - PREFETCH: the decoded row in the prefetch ring; valid until that ring half is
+    //   recycled, which can happen as soon as iteration moves past the half.
+    // Only STREAMING avoids copying TEXT and BLOB cells. Copy the data out of a view
+    // that must outlive these bounds.
+    template <typename T>
+    struct ColumnValue {
+        typedef const T &type;
+    };
+
+    template <>
+    struct ColumnValue<std::string_view> {
+        typedef std::string_view type;
+    };
+
+    template <>
+    struct ColumnValue<std::span<const std::byte>> {
+        typedef std::span<const std::byte> type;
+    };
+
+    // Compile-time string literal usable as a template argument.
+    template <size_t N>
+    struct FixedString {
+        char value[N];
+
+        constexpr FixedString(const char (&str)[N]) {
+            for (size_t i = 0; i < N; i++) {
+                value[i] = str[i];
+            }
+        }
+
+        constexpr std::string_view view() const {
+            return std::string_view(value, N - 1);
+        }
     };
 
     class Results {
+    public:
+        // BUFFERED materializes every row before iteration.
+        // STREAMING steps the statement lazily and holds only the current row,
+        // so the results can be iterated only once and count() is not available.
+        // PREFETCH is STREAMING with a helper thread stepping ahead into a bounded
+        // double-buffered ring of decoded rows; ResultIterator::operator++ pops from it.
+        // The connection must not be used by anything else until iteration ends.
+        enum class Mode {
+            BUFFERED,
+            STREAMING,
+            PREFETCH
+        };
+
     private:
         class ResultIterator {
         public:
-            const ResultIterator &operator++();
+            typedef std::input_iterator_tag iterator_category;
+            typedef ResultIterator value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const ResultIterator *pointer;
+            typedef const ResultIterator &reference;
+
+            ResultIterator();
+
+            ResultIterator &operator++();
+            void operator++(int);
+
+            reference operator*() const;
+            pointer operator->() const;
+
+            bool operator==(const ResultIterator &other) const;
 
             template <typename T>
-            const T &get(const std::string &column_name) const;
+            typename ColumnValue<T>::type get(const std::string_view column_name) const;
 
             template <typename T>
-            const T &get(const std::string &column_index) const;
+            typename ColumnValue<T>::type get(const size_t column_index) const;
+
+            template <FixedString column_name, typename T>
+            typename ColumnValue<T>::type get() const;
         };
     public:
         typedef ResultIterator iterator;
 
+        Results();
+        explicit Results(const Mode mode);
+        // prefetch_rows is the size of each half of the PREFETCH ring.
+        Results(const Mode mode, const size_t prefetch_rows);
+        ~Results();
+
+        Results(const Results &) = delete;
+        Results &operator=(const Results &) = delete;
+        Results(Results &&other) noexcept;
+        Results &operator=(Results &&other) noexcept;
+
+        Mode mode() const;
         size_t count() const;
+        // Error that stopped STREAMING or PREFETCH iteration, or OK if the rows ran out.
+        // exec() only reports errors up to the first row; a later failing step (e.g.
+        // SQLITE_BUSY, SQLITE_IOERR or TIMEOUT) ends iteration and is reported here.
+        const Error &error() const;
 
+        // Column names are resolved through a sorted name-to-index table built once
+        // per statement, so access by name costs a lookup without allocation. Names are
+        // matched exactly and case-sensitively against sqlite3_column_name, and when several
+        // columns share a name (SELECT a.id, b.id) the leftmost one wins.
         template <typename T>
-        const T &get(const std::string &column_name) const;
+        typename ColumnValue<T>::type get(const std::string_view column_name) const;
 
         template <typename T>
-        const T &get(const std::string &column_index) const;
+        typename ColumnValue<T>::type get(const size_t column_index) const;
+
+        // Same lookup as get(std::string_view) with a literal name and no conversion at the
+        // call site, e.g. results.get<"name", std::string>().
+        template <FixedString column_name, typename T>
+        typename ColumnValue<T>::type get() const;
+
+        const iterator &begin() const;
+        const iterator &end() const;
+    };
+
+    // Row type of TypedResults: a single aggregate struct is decoded field by field,
+    // otherwise the columns are decoded into a std::tuple.
+    template <typename... Columns>
+    struct RowType {
+        typedef std::tuple<Columns...> type;
+    };
+
+    template <typename Row>
+    struct RowType<Row> {
+        typedef std::conditional_t<std::is_aggregate_v<Row>, Row, std::tuple<Row>> type;
+    };
+
+    // Results with a compile-time row schema. Columns are matched by position once
+    // when the statement is executed and each row is decoded straight into row_type,
+    // so there are no per-cell name lookups or runtime type dispatch.
+    template <typename... Columns>
+    class TypedResults {
+    public:
+        typedef typename RowType<Columns...>::type row_type;
+
+        TypedResults();
+        ~TypedResults();
+
+        TypedResults(const TypedResults &) = delete;
+        TypedResults &operator=(const TypedResults &) = delete;
+        TypedResults(TypedResults &&other) noexcept;
+        TypedResults &operator=(TypedResults &&other) noexcept;
+
+        class iterator {
+        public:
+            typedef std::input_iterator_tag iterator_category;
+            typedef row_type value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const row_type *pointer;
+            typedef const row_type &reference;
+
+            iterator();
+
+            iterator &operator++();
+            void operator++(int);
+
+            reference operator*() const;
+            pointer operator->() const;
+
+            bool operator==(const iterator &other) const;
+        };
+
+        size_t count() const;
+        const row_type &get(const size_t row_index) const;
 
         const iterator &begin() const;
         const iterator &end() const;
     };
 
-    const Error exec(Database &db, const std::string &sql, const Results &res = Results());
-    const Error exec(Statement &st, const Results &res = Results());
+    // Batched alternative to Results: each fetch() steps up to capacity() rows
+    // and writes them contiguously into the bound column buffers. Buffers are
+    // sized to capacity() once and reused between fetches. NULL is stored as T(), so bind
+    // a null indicator buffer to tell NULL apart from T() values.
+    class ColumnBatch {
+    public:
+        ColumnBatch(Statement &st, const size_t capacity);
+
+        template <typename T>
+        const Error &bind_column(const size_t column_index, std::vector<T> &buffer);
+        // is_null[i] is set to 1 when the column of row i is NULL and to 0 otherwise.
+        template <typename T>
+        const Error &bind_column(const size_t column_index, std::vector<T> &buffer, std::vector<uint8_t> &is_null);
+
+        // rows_fetched is 0 once the statement is done.
+        const Error &fetch(size_t &rows_fetched);
+
+        size_t capacity() const;
+    };
+
+    const Error exec(Database &db, const std::string &sql) noexcept;
+    const Error exec(Database &db, const std::string &sql, Results &res);
+    // Returns TIMEOUT if the statement is still running at deadline.
+    const Error exec(Database &db, const std::string &sql, const Deadline deadline) noexcept;
+    const Error exec(Database &db, const std::string &sql, Results &res, const Deadline deadline);
+    // With Results::Mode::STREAMING, for (auto &row : exec(db, sql, err, Results::Mode::STREAMING))
+    // runs in constant memory. err reports errors up to the first row; errors during
+    // iteration are reported by Results::error().
+    Results exec(Database &db, const std::string &sql, Error &err, const Results::Mode mode = Results::Mode::BUFFERED);
+    // Leaves the statement reset and ready to be re-executed with new bindings.
+    const Error exec(Statement &st) noexcept;
+    const Error exec(Statement &st, Results &res);
+    Results exec(Statement &st, Error &err, const Results::Mode mode = Results::Mode::BUFFERED);
+
+    // Returns an error if the number of result columns does not match the row schema.
+    template <typename... Columns>
+    const Error exec(Database &db, const std::string &sql, TypedResults<Columns...> &res);
+    template <typename... Columns>
+    const Error exec(Statement &st, TypedResults<Columns...> &res);
+
+    // N read-only connections plus one writer connection on the same file in WAL mode.
+    // Read-only statements (sqlite3_stmt_readonly) run on any free reader, everything
+    // else is serialized on the writer. Leases block until a connection is free.
+    // exec() runs one statement per lease, so it rejects with SQLITE_MISUSE:
+    // - transaction control (BEGIN, COMMIT, END, ROLLBACK, SAVEPOINT, RELEASE), which SQLite
+    //   reports as read-only; run transactions on a writer() lease with sqlite::Transaction.
+    // - STREAMING and PREFETCH results, which would keep stepping on a connection that is
+    //   already back in the pool; lease a connection to stream from it.
+    class ConnectionPool {
+    public:
+        struct Stats {
+            size_t reads;
+            size_t writes;
+            std::chrono::nanoseconds read_wait;
+            std::chrono::nanoseconds write_wait;
+            // Fraction of the pool lifetime the connections were leased.
+            double reader_utilization;
+            double writer_utilization;
+        };
+
+        // Returns the connection to the pool on destruction.
+        class Lease {
+        public:
+            ~Lease();
+
+            Lease(const Lease &) = delete;
+            Lease &operator=(const Lease &) = delete;
+            Lease(Lease &&other) noexcept;
+            Lease &operator=(Lease &&other) noexcept;
+
+            Database &db();
+        };
+
+        ConnectionPool(const std::string &path, const size_t readers);
+
+        ConnectionPool(const ConnectionPool &) = delete;
+        ConnectionPool &operator=(const ConnectionPool &) = delete;
+
+        Lease reader();
+        Lease writer();
+
+        const Error exec(const std::string &sql);
+        const Error exec(const std::string &sql, Results &res);
+
+        size_t readers() const;
+        Stats stats() const;
+    };
+
+    // Coalesces write units submitted from many threads into one physical transaction.
+    // A committer thread owning its own connection folds every unit that arrived within
+    // window (or up to max_units units) into one transaction, running each unit in its own
+    // savepoint so a failing unit is rolled back alone. A unit's future resolves after the
+    // shared commit is durable, with the unit's own error or the commit error. Errors carry
+    // a copy of their message, so they stay readable from the caller's thread and after the
+    // GroupCommit and its connection are destroyed.
+    class GroupCommit {
+    public:
+        typedef std::function<Error(Database &db)> WriteUnit;
+
+        struct Stats {
+            size_t units;
+            size_t commits;
+        };
+
+        GroupCommit(const std::string &path, const std::chrono::microseconds window, const size_t max_units);
+        // Commits pending units and stops the committer thread.
+        ~GroupCommit();
+
+        GroupCommit(const GroupCommit &) = delete;
+        GroupCommit &operator=(const GroupCommit &) = delete;
+
+        std::future<Error> submit(WriteUnit unit);
+
+        Stats stats() const;
+    };
+
+    // What AsyncWriter::enqueue does when the queue is full.
+    enum class OverflowPolicy {
+        BLOCK,
+        DROP
+    };
+
+    // Fire-and-forget writer for one prepared INSERT. Producers push bound parameter
+    // tuples into a bounded lock-free multi-producer single-consumer ring, and one writer
+    // thread owning its own connection drains it in transactions of up to batch_size rows.
+    // A transaction that fails with SQLITE_BUSY is retried until the lock is released, while
+    // the ring keeps filling.
+    template <typename... Columns>
+    class AsyncWriter {
+    public:
+        struct Stats {
+            size_t depth;
+            size_t written;
+            size_t dropped;
+            // Rows written per second over the most recent drain.
+            double drain_rate;
+        };
+
+        AsyncWriter(const std::string &path, const std::string &sql, const size_t capacity,
+                    const OverflowPolicy policy, const size_t batch_size);
+        // Drains the queue and stops the writer thread.
+        ~AsyncWriter();
+
+        AsyncWriter(const AsyncWriter &) = delete;
+        AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+        // Returns false if the row was dropped because the queue was full.
+        bool enqueue(Columns... values);
+
+        // Blocks until every row enqueued so far has been committed.
+        const Error flush();
+
+        Stats stats() const;
+    };
+
+    // Shared cancellation flag. Copies refer to the same flag. Cancelling a query that is
+    // running calls sqlite3_interrupt on its connection; a query that has not started is skipped.
+    class CancellationToken {
+    public:
+        CancellationToken();
+
+        void cancel();
+        bool cancelled() const;
+        // True while a query this token was passed to is executing on a worker.
+        bool running() const;
+    };
+
+    // Fixed set of database worker threads, each owning its own connection to path.
+    class QueryWorkerPool {
+    public:
+        QueryWorkerPool(const std::string &path, const size_t threads);
+        // Finishes queued queries and joins the workers.
+        ~QueryWorkerPool();
+
+        QueryWorkerPool(const QueryWorkerPool &) = delete;
+        QueryWorkerPool &operator=(const QueryWorkerPool &) = delete;
+
+        size_t size() const;
+    };
+
+    // Runs sql on a pool worker with params bound in order. Errors are delivered through the
+    // future as sqlite::Exception. A cancelled query, whether interrupted while running or
+    // skipped before it started, holds an Exception whose error code is SQLITE_INTERRUPT.
+    template <typename... Params>
+    std::future<Results> async_exec(QueryWorkerPool &pool, const std::string &sql, const Params &...params);
+    template <typename... Params>
+    std::future<Results> async_exec(QueryWorkerPool &pool, const CancellationToken &token, const std::string &sql, const Params &...params);
+
+    // Fire-and-forget coroutine started by EventLoop::spawn.
+    class Task {
+    public:
+        struct promise_type {
+            Task get_return_object();
+            std::suspend_always initial_suspend() noexcept;
+            std::suspend_always final_suspend() noexcept;
+            void return_void() noexcept;
+            void unhandled_exception() noexcept;
+        };
+
+        ~Task();
+
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+        Task(Task &&other) noexcept;
+        Task &operator=(Task &&other) noexcept;
+
+        bool done() const;
+    };
+
+    // Reference single-threaded executor resuming coroutines in FIFO order.
+    class EventLoop {
+    public:
+        EventLoop();
+
+        EventLoop(const EventLoop &) = delete;
+        EventLoop &operator=(const EventLoop &) = delete;
+
+        void spawn(Task task);
+        void post(std::coroutine_handle<> handle);
+
+        // Resumes coroutines that are ready now and returns. Calls made while run_pending()
+        // is already active on the loop return immediately, so pumping never nests.
+        void run_pending();
+        // Runs until every spawned task is done.
+        void run();
+    };
+
+    // Awaitable returned by query(). The statement is stepped on the loop thread. With
+    // yield_instructions > 0 the connection's progress handler calls
+    // loop.run_pending() every yield_instructions VM instructions, so other tasks keep
+    // running during one long step. Tasks resumed this way must not use the same connection.
+    // With yield_instructions == 0 the loop is blocked for the whole of each step. A yielding
+    // query resumed from inside another query's progress handler does not pump the loop again
+    // until the outer run_pending() returns, so the stack depth stays bounded at one level.
+    class Query {
+    public:
+        Query(EventLoop &loop, Database &db, const std::string &sql, Error &err, const size_t yield_instructions);
+        Query(EventLoop &loop, Database &db, const std::string &sql, Error &err, const size_t yield_instructions,
+              const Deadline deadline);
+
+        bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<> handle);
+        Results await_resume();
+    };
+
+    Query query(EventLoop &loop, Database &db, const std::string &sql, Error &err, const size_t yield_instructions = 0);
+    // Sets err to TIMEOUT if the statement is still running at deadline.
+    Query query(EventLoop &loop, Database &db, const std::string &sql, Error &err, const size_t yield_instructions,
+                const Deadline deadline);
+
+    // Table scan split on an integer key (rowid or an indexed column). Each sub-range runs
+    // SELECT <columns> FROM <table> WHERE <key> >= ? AND <key> < ? [AND (<where>)], except
+    // the last one, which uses <key> <= ? with max(key) so that no bound past max is needed.
+    struct ScanSpec {
+        std::string table;
+        std::string columns = "*";
+        std::string key = "rowid";
+        std::string where = "";
+    };
+
+    enum class MergeOrder {
+        // Sub-range results are appended in the order the sub-ranges finish.
+        UNORDERED,
+        // Sub-ranges are read ordered by key and k-way merged; columns must include key.
+        BY_KEY
+    };
+
+    // Splits [min(key), max(key)] into n sub-ranges of equal width and scans each on its own
+    // thread with its own reader lease from pool, then merges the outputs into res. Widths are
+    // computed in unsigned 64-bit arithmetic, so keys spanning the whole int64 range, including
+    // max(key) == INT64_MAX, are covered. min and max are read inside a Snapshot that every
+    // sub-range opens with a SnapshotTransaction, so all sub-ranges see the same database state.
+    // The lease used to read min and max is returned before the sub-range leases are taken, so
+    // n may equal pool.readers(). An empty table (NULL min and max) returns OK with no rows and
+    // starts no threads. n == 0 returns SQLITE_MISUSE.
+    const Error parallel_scan(ConnectionPool &pool, const ScanSpec &spec, const size_t n, Results &res,
+                              const MergeOrder order = MergeOrder::UNORDERED);
+
+    // Maps every sub-range's results to a T on its scan thread and folds the values with reduce
+    // into value as sub-ranges finish, so reduce must be associative and commutative. value is
+    // folded in exactly once and does not need to be an identity of reduce. An empty table
+    // leaves value unchanged.
+    template <typename T>
+    const Error parallel_scan(ConnectionPool &pool, const ScanSpec &spec, const size_t n, T &value,
+                              const std::function<T(const Results &part)> &map, const std::function<T(T, T)> &reduce);
+
+    // Fixed set of threads with per-thread deques; idle threads steal chunks from busy ones.
+    class WorkStealingPool {
+    public:
+        explicit WorkStealingPool(const size_t threads);
+        // Finishes queued chunks and joins the threads.
+        ~WorkStealingPool();
+
+        WorkStealingPool(const WorkStealingPool &) = delete;
+        WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+        // Process-wide pool sized to std::thread::hardware_concurrency().
+        static WorkStealingPool &shared();
+
+        size_t size() const;
+    };
+
+    // Splits the rows of BUFFERED results into chunks of grain rows and runs fn on every row
+    // from the pool threads. Rows are visited in place, never copied, and fn may run
+    // concurrently for different rows. Returns an error for non-BUFFERED results.
+    const Error parallel_for_each(WorkStealingPool &pool, const Results &results,
+                                  const std::function<void(const Results::iterator &row)> &fn, const size_t grain);
+    const Error parallel_for_each(const Results &results, const std::function<void(const Results::iterator &row)> &fn,
+                                  const size_t grain);
+
+    // Maps every row with transform and folds the values with reduce into value. Each chunk
+    // starts from its first transformed row and chunk results are folded in as chunks finish,
+    // with the same requirements on reduce and value as parallel_scan's reduce overload.
+    template <typename T>
+    const Error parallel_transform_reduce(WorkStealingPool &pool, const Results &results, T &value,
+                                          const std::function<T(const Results::iterator &row)> &transform,
+                                          const std::function<T(T, T)> &reduce, const size_t grain);
+    template <typename T>
+    const Error parallel_transform_reduce(const Results &results, T &value,
+                                          const std::function<T(const Results::iterator &row)> &transform,
+                                          const std::function<T(T, T)> &reduce, const size_t grain);
+
+    // Runs body inside a Transaction and commits it. If body or the commit fails with
+    // SQLITE_BUSY the transaction is rolled back and retried, up to max_attempts times,
+    // waiting between attempts according to the database busy strategy.
+    const Error retry_transaction(Database &db, const std::function<Error(Database &db)> &body, const size_t max_attempts);
+
+    // Inserts rows with INSERT ... VALUES (?, ?), (?, ?), ... statements holding as many rows
+    // as the connection's SQLITE_LIMIT_VARIABLE_NUMBER allows. The full-chunk and tail-chunk
+    // statements go through the database statement cache, so each size is prepared once.
+    class MultiRowInsert {
+    public:
+        MultiRowInsert(Database &db, const std::string &table, const std::vector<std::string> &columns);
+
+        size_t rows_per_chunk() const;
+
+        // Like Statement::exec_batch, rows are committed in one Transaction every batch_size
+        // rows (0 means all rows), so both paths pay for the same number of commits.
+        template <std::ranges::input_range Range>
+        const Error exec(Range &&rows, const size_t batch_size = 0);
+    };
+
+    // Statement::exec_batch on a statement prepared from sql, with the same failure behaviour.
+    template <std::ranges::input_range Range>
+    const Error bulk_insert(Database &db, const std::string &sql, Range &&rows, const size_t batch_size = 0);
+    template <std::ranges::input_range Range>
+    const Error bulk_insert(Database &db, const std::string &sql, Range &&rows, const size_t batch_size,
+                            size_t &rows_committed);
+
+    // Streams rows into a TEMP staging table and merges it into table with one
+    // INSERT ... SELECT ... ON CONFLICT (conflict_columns) DO UPDATE inside a single Transaction.
+    // The staging table is created once per connection and table, and emptied after each merge.
+    template <std::ranges::input_range Range>
+    const Error upsert_batch(Database &db, const std::string &table, const std::vector<std::string> &columns,
+                             const std::vector<std::string> &conflict_columns, Range &&rows);
 
-    const Error OK(0, "");
+    inline constexpr Error OK(0);
 };
 
 #endif // __SQLITE_HPP__
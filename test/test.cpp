@@ -1,12 +1,54 @@
 #include <iostream>
+#include <ranges>
+#include <new>
+#include <cstdlib>
+#include <type_traits>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <algorithm>
 #include "catch_amalgamated.hpp"
 #include "../include/sqlite.hpp"
 
+// Counts C++ heap allocations. SQLite allocates through its own allocator and is not counted.
+static std::atomic<size_t> allocations = 0;
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+struct Customer {
+    int id;
+    std::string name;
+    int age;
+};
+
+// Removes the database file and its journals so every test starts from a new
+// rollback-journal database, whatever journal mode an earlier test left behind.
+static const std::string &fresh_database(const std::string &path) {
+    for (const std::string suffix : { "", "-journal", "-wal", "-shm" }) {
+        std::remove((path + suffix).c_str());
+    }
+    return path;
+}
+
 class TestSetup {
 public:
     sqlite::Database db;
 
-    TestSetup(): db("test.db") {
+    TestSetup(): db(fresh_database("test.db")) {
         if(sqlite::exec(db, "DROP TABLE IF EXISTS Customers;")) {
             std::cerr << "Drop Customers table" << std::endl;
         }
@@ -17,6 +59,16 @@ public:
     }
 };
 
+// Inserts customers with ids 0 to rows - 1 and ages id % 100.
+static void fill_customers(sqlite::Database &db, const int rows) {
+    sqlite::Statement statement(db, "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);");
+    std::vector<std::tuple<int, std::string, int>> customers;
+    for (int id = 0; id < rows; id++) {
+        customers.emplace_back(id, "John", id % 100);
+    }
+    statement.exec_batch(customers);
+}
+
 TEST_CASE("Test Statement class") {
     SECTION("It can bind parameters by name in a statement") {
         TestSetup setup;
@@ -77,22 +129,81 @@ TEST_CASE("Test Statement class") {
     SECTION("It cannot bind parameter with an invalid column id") {
         TestSetup setup;
         const int invalid_column_id = 10, value = 1;
-        const std::string expected_err_msg = "An invalid column id";
+        const std::string expected_err_msg = "column index out of range";
             
         sqlite::Statement statement(setup.db, "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);");
         statement.bind(invalid_column_id, value);
         sqlite::Error err = sqlite::exec(statement);
         REQUIRE(err.msg() == expected_err_msg);
     }
+
+    SECTION("It can re-execute a statement with new bindings") {
+        TestSetup setup;
+
+        sqlite::Statement statement(setup.db, "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);");
+        for (int id = 1; id <= 3; id++) {
+            statement.bind(0, id);
+            statement.bind(1, std::string("John"));
+            statement.bind(2, 29);
+            REQUIRE_FALSE(sqlite::exec(statement));
+        }
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+        REQUIRE(results.count() == 3);
+    }
+
+    SECTION("It restarts a partly stepped statement with the same bindings after reset") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 29);");
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (2, 'Robert', 29);");
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (3, 'David', 22);");
+
+        sqlite::Statement statement(setup.db, "SELECT id FROM Customers WHERE age = ? ORDER BY id;");
+        statement.bind(0, 29);
+
+        {
+            sqlite::Results results(sqlite::Results::Mode::STREAMING);
+            sqlite::exec(statement, results);
+            auto it = results.begin();
+            REQUIRE(it->get<int>("id") == 1);
+            ++it;
+            REQUIRE(it->get<int>("id") == 2);
+        }
+        REQUIRE_FALSE(statement.reset());
+
+        sqlite::Results results(sqlite::Results::Mode::STREAMING);
+        sqlite::exec(statement, results);
+        std::vector<int> ids;
+        for (auto &row : results) {
+            ids.push_back(row.get<int>("id"));
+        }
+        REQUIRE(ids == std::vector<int>{ 1, 2 });
+    }
+
+    SECTION("It can clear bindings") {
+        TestSetup setup;
+
+        sqlite::Statement statement(setup.db, "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);");
+        statement.bind(0, 1);
+        statement.bind(1, std::string("John"));
+        statement.bind(2, 29);
+        statement.clear_bindings();
+        sqlite::exec(statement);
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers WHERE id IS NULL AND name IS NULL AND age IS NULL;", results);
+        REQUIRE(results.count() == 1);
+    }
 }
 
 TEST_CASE("Test Transaction class") {
     SECTION("It can commit a transaction") {
         TestSetup setup;
-        const std::string expected_err_msg = "Customers table does not exist";
+        const std::string expected_err_msg = "no such table: Customers";
 
         sqlite::Transaction tx(setup.db);
-        sqlite::exec(setup.db, "DELETE FROM Customers;");
+        sqlite::exec(setup.db, "DROP TABLE Customers;");
         tx.commit();
 
         sqlite::Error err = sqlite::exec(setup.db, "SELECT * FROM Customers;");
@@ -113,4 +224,1384 @@ TEST_CASE("Test Transaction class") {
         sqlite::Error err = sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
         REQUIRE(results.count() == 1);
     }
+
+    SECTION("It can roll back a nested transaction only") {
+        TestSetup setup;
+
+        sqlite::Transaction outer(setup.db);
+        REQUIRE_FALSE(outer.nested());
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 18);");
+        {
+            sqlite::Transaction inner(setup.db);
+            REQUIRE(inner.nested());
+            sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (2, 'Robert', 22);");
+            inner.rollback();
+        }
+        REQUIRE_FALSE(outer.commit());
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+        REQUIRE(results.count() == 1);
+    }
+
+    SECTION("It can commit a nested transaction") {
+        TestSetup setup;
+
+        {
+            sqlite::Transaction outer(setup.db, sqlite::TransactionLevel::IMMEDIATE);
+            {
+                sqlite::Transaction inner(setup.db);
+                sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 18);");
+                REQUIRE_FALSE(inner.commit());
+            }
+            REQUIRE_FALSE(outer.commit());
+        }
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+        REQUIRE(results.count() == 1);
+    }
+
+    SECTION("It can begin an exclusive transaction") {
+        TestSetup setup;
+        sqlite::Database other("test.db");
+
+        sqlite::Transaction tx(setup.db, sqlite::TransactionLevel::EXCLUSIVE);
+        REQUIRE(sqlite::exec(other, "SELECT * FROM Customers;"));
+    }
+}
+
+TEST_CASE("Test bulk insert") {
+    SECTION("It can insert a range of tuples") {
+        TestSetup setup;
+        const std::vector<std::tuple<int, std::string, int>> rows = {
+            { 1, "John", 31 },
+            { 2, "Robert", 22 },
+            { 3, "David", 22 }
+        };
+
+        REQUIRE_FALSE(sqlite::bulk_insert(setup.db, "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);", rows));
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+        REQUIRE(results.count() == 3);
+    }
+
+    SECTION("It can insert a range of aggregates in batches") {
+        TestSetup setup;
+        const std::vector<Customer> rows = {
+            { 1, "John", 31 },
+            { 2, "Robert", 22 },
+            { 3, "David", 22 }
+        };
+
+        sqlite::Statement statement(setup.db, "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);");
+        REQUIRE_FALSE(statement.exec_batch(rows, 2));
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers WHERE name = 'David' AND age = 22;", results);
+        REQUIRE(results.count() == 1);
+    }
+
+    SECTION("It keeps earlier batches when a row in a later batch fails") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "CREATE UNIQUE INDEX CustomersId ON Customers(id);");
+        const std::vector<Customer> rows = {
+            { 1, "John", 31 },
+            { 2, "Robert", 22 },
+            { 3, "David", 22 },
+            { 1, "John", 31 }, // duplicate id fails the second batch
+            { 5, "Maria", 27 }
+        };
+
+        size_t rows_committed = 0;
+        REQUIRE(sqlite::bulk_insert(setup.db, "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);", rows, 2,
+                                    rows_committed));
+        REQUIRE(rows_committed == 2);
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+        REQUIRE(results.count() == 2);
+    }
+}
+
+TEST_CASE("Test MultiRowInsert class") {
+    SECTION("It can insert rows in multi-row chunks") {
+        TestSetup setup;
+        sqlite::MultiRowInsert insert(setup.db, "Customers", { "id", "name", "age" });
+        REQUIRE(insert.rows_per_chunk() > 1);
+
+        // Two full chunks and a one-row tail chunk
+        std::vector<std::tuple<int, std::string, int>> rows;
+        for (size_t id = 0; id < 2 * insert.rows_per_chunk() + 1; id++) {
+            rows.emplace_back(static_cast<int>(id), "John", 29);
+        }
+        REQUIRE_FALSE(insert.exec(rows));
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+        REQUIRE(results.count() == rows.size());
+    }
+}
+
+TEST_CASE("Test upsert batch") {
+    SECTION("It can insert new rows and update existing rows") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "CREATE UNIQUE INDEX CustomersId ON Customers(id);");
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+
+        const std::vector<Customer> rows = {
+            { 1, "John", 32 },
+            { 2, "Robert", 22 }
+        };
+        REQUIRE_FALSE(sqlite::upsert_batch(setup.db, "Customers", { "id", "name", "age" }, { "id" }, rows));
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+        REQUIRE(results.count() == 2);
+
+        sqlite::exec(setup.db, "SELECT age FROM Customers WHERE id = 1;", results);
+        REQUIRE(results.get<int>("age") == 32);
+    }
+
+    SECTION("It can reuse the staging table across calls") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "CREATE UNIQUE INDEX CustomersId ON Customers(id);");
+
+        const std::vector<Customer> first = { { 1, "John", 31 } };
+        const std::vector<Customer> second = { { 2, "Robert", 22 } };
+        REQUIRE_FALSE(sqlite::upsert_batch(setup.db, "Customers", { "id", "name", "age" }, { "id" }, first));
+        REQUIRE_FALSE(sqlite::upsert_batch(setup.db, "Customers", { "id", "name", "age" }, { "id" }, second));
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+        REQUIRE(results.count() == 2);
+    }
+}
+
+TEST_CASE("Test ConnectionPool class") {
+    SECTION("It can run reads concurrently and serialize writes") {
+        { TestSetup setup; }
+        sqlite::ConnectionPool pool("test.db", 4);
+        REQUIRE(pool.readers() == 4);
+        REQUIRE_FALSE(pool.exec("INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);"));
+
+        std::vector<std::thread> threads;
+        std::vector<size_t> counts(pool.readers());
+        for (size_t i = 0; i < pool.readers(); i++) {
+            threads.emplace_back([&pool, &counts, i]() {
+                sqlite::Results results;
+                pool.exec("SELECT * FROM Customers;", results);
+                counts[i] = results.count();
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        for (size_t count : counts) {
+            REQUIRE(count == 1);
+        }
+        REQUIRE(pool.stats().reads == pool.readers());
+        REQUIRE(pool.stats().writes == 1);
+    }
+
+    SECTION("It runs transactions on a writer lease only") {
+        { TestSetup setup; }
+        sqlite::ConnectionPool pool("test.db", 2);
+        REQUIRE(pool.exec("BEGIN;"));
+        REQUIRE(pool.exec("SAVEPOINT sp;"));
+
+        {
+            sqlite::ConnectionPool::Lease writer = pool.writer();
+            sqlite::Transaction tx(writer.db());
+            sqlite::exec(writer.db(), "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+            // rolled back without tx.commit()
+        }
+
+        sqlite::Results results;
+        REQUIRE_FALSE(pool.exec("SELECT * FROM Customers;", results));
+        REQUIRE(results.count() == 0);
+    }
+
+    SECTION("It cannot stream results through exec") {
+        { TestSetup setup; }
+        sqlite::ConnectionPool pool("test.db", 2);
+
+        sqlite::Results streaming(sqlite::Results::Mode::STREAMING);
+        REQUIRE(pool.exec("SELECT * FROM Customers;", streaming));
+        sqlite::Results prefetch(sqlite::Results::Mode::PREFETCH);
+        REQUIRE(pool.exec("SELECT * FROM Customers;", prefetch));
+
+        sqlite::ConnectionPool::Lease reader = pool.reader();
+        REQUIRE_FALSE(sqlite::exec(reader.db(), "SELECT * FROM Customers;", streaming));
+    }
+
+    SECTION("It can lease connections directly") {
+        { TestSetup setup; }
+        sqlite::ConnectionPool pool("test.db", 2);
+
+        {
+            sqlite::ConnectionPool::Lease writer = pool.writer();
+            REQUIRE_FALSE(sqlite::exec(writer.db(), "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);"));
+        }
+
+        sqlite::ConnectionPool::Lease reader = pool.reader();
+        REQUIRE(sqlite::exec(reader.db(), "DELETE FROM Customers;"));
+    }
+}
+
+TEST_CASE("Test Snapshot class") {
+    SECTION("It gives pooled readers a consistent view") {
+        { TestSetup setup; }
+        sqlite::ConnectionPool pool("test.db", 2);
+        pool.exec("INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+
+        sqlite::ConnectionPool::Lease first = pool.reader();
+        sqlite::Snapshot snapshot(first.db());
+        REQUIRE_FALSE(snapshot.error());
+
+        pool.exec("INSERT INTO Customers (id, name, age) VALUES (2, 'Robert', 22);");
+
+        std::vector<size_t> counts(2);
+        std::thread second_reader([&pool, &snapshot, &counts]() {
+            sqlite::ConnectionPool::Lease second = pool.reader();
+            sqlite::SnapshotTransaction tx(second.db(), snapshot);
+            sqlite::Results results;
+            sqlite::exec(second.db(), "SELECT * FROM Customers;", results);
+            counts[1] = results.count();
+        });
+
+        {
+            sqlite::SnapshotTransaction tx(first.db(), snapshot);
+            REQUIRE_FALSE(tx.error());
+            sqlite::Results results;
+            sqlite::exec(first.db(), "SELECT * FROM Customers;", results);
+            counts[0] = results.count();
+        }
+        second_reader.join();
+
+        REQUIRE(counts[0] == 1);
+        REQUIRE(counts[1] == 1);
+    }
+}
+
+TEST_CASE("Test parallel scan") {
+    const int rows = 1000;
+    SECTION("It can scan sub-ranges in parallel without ordering") {
+        {
+            TestSetup setup;
+            fill_customers(setup.db, rows);
+        }
+        sqlite::ConnectionPool pool("test.db", 4);
+
+        sqlite::Results results;
+        REQUIRE_FALSE(sqlite::parallel_scan(pool, { "Customers" }, 4, results));
+        REQUIRE(results.count() == rows);
+    }
+
+    SECTION("It can merge sub-ranges ordered by key") {
+        {
+            TestSetup setup;
+            fill_customers(setup.db, rows);
+        }
+        sqlite::ConnectionPool pool("test.db", 4);
+
+        sqlite::Results results;
+        REQUIRE_FALSE(sqlite::parallel_scan(pool, { "Customers", "rowid, id", "rowid", "age < 50" }, 4, results,
+                                            sqlite::MergeOrder::BY_KEY));
+        REQUIRE(results.count() == rows / 2);
+
+        int last_id = -1;
+        for (auto &row : results) {
+            REQUIRE(row.get<int>("id") > last_id);
+            last_id = row.get<int>("id");
+        }
+    }
+
+    SECTION("It can scan up to the largest key") {
+        {
+            TestSetup setup;
+            sqlite::exec(setup.db, "INSERT INTO Customers (rowid, id, name, age) VALUES (-9223372036854775808, 1, 'John', 31);");
+            sqlite::exec(setup.db, "INSERT INTO Customers (rowid, id, name, age) VALUES (9223372036854775807, 2, 'Robert', 22);");
+        }
+        sqlite::ConnectionPool pool("test.db", 4);
+
+        sqlite::Results results;
+        REQUIRE_FALSE(sqlite::parallel_scan(pool, { "Customers" }, 4, results));
+        REQUIRE(results.count() == 2);
+    }
+
+    SECTION("It can reduce sub-ranges") {
+        {
+            TestSetup setup;
+            fill_customers(setup.db, rows);
+        }
+        sqlite::ConnectionPool pool("test.db", 4);
+
+        size_t count = 0;
+        REQUIRE_FALSE(sqlite::parallel_scan<size_t>(pool, { "Customers" }, 4, count,
+            [](const sqlite::Results &part) { return part.count(); },
+            [](size_t a, size_t b) { return a + b; }));
+        REQUIRE(count == rows);
+    }
+
+    SECTION("It can scan an empty table") {
+        { TestSetup setup; }
+        sqlite::ConnectionPool pool("test.db", 4);
+
+        sqlite::Results results;
+        REQUIRE_FALSE(sqlite::parallel_scan(pool, { "Customers" }, 4, results));
+        REQUIRE(results.count() == 0);
+
+        size_t count = 7;
+        REQUIRE_FALSE(sqlite::parallel_scan<size_t>(pool, { "Customers" }, 4, count,
+            [](const sqlite::Results &part) { return part.count(); },
+            [](size_t a, size_t b) { return a + b; }));
+        REQUIRE(count == 7);
+    }
+
+    SECTION("It rejects zero sub-ranges") {
+        { TestSetup setup; }
+        sqlite::ConnectionPool pool("test.db", 4);
+
+        sqlite::Results results;
+        REQUIRE(sqlite::parallel_scan(pool, { "Customers" }, 0, results).code() == 21); // SQLITE_MISUSE
+    }
+}
+
+TEST_CASE("Test parallel processing of results") {
+    const int rows = 1000;
+    SECTION("It can visit every row in parallel") {
+        TestSetup setup;
+        fill_customers(setup.db, rows);
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+
+        sqlite::WorkStealingPool pool(4);
+        std::atomic<int> total = 0;
+        REQUIRE_FALSE(sqlite::parallel_for_each(pool, results, [&total](const sqlite::Results::iterator &row) {
+            total += row.get<int>("id");
+        }, 64));
+        REQUIRE(total == rows * (rows - 1) / 2);
+    }
+
+    SECTION("It can transform and reduce rows in parallel") {
+        TestSetup setup;
+        fill_customers(setup.db, rows);
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+
+        long long sum = 0;
+        REQUIRE_FALSE(sqlite::parallel_transform_reduce<long long>(results, sum,
+            [](const sqlite::Results::iterator &row) { return static_cast<long long>(row.get<int>("id")); },
+            [](long long a, long long b) { return a + b; }, 64));
+        REQUIRE(sum == static_cast<long long>(rows) * (rows - 1) / 2);
+    }
+
+    SECTION("It cannot process streaming results in parallel") {
+        TestSetup setup;
+        sqlite::Results results(sqlite::Results::Mode::STREAMING);
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+
+        REQUIRE(sqlite::parallel_for_each(results, [](const sqlite::Results::iterator &) {}, 64));
+    }
+}
+
+TEST_CASE("Test GroupCommit class") {
+    SECTION("It can commit units from many threads together") {
+        { TestSetup setup; }
+        const int units = 64;
+
+        {
+            sqlite::GroupCommit group("test.db", std::chrono::milliseconds(10), units);
+            std::vector<std::future<sqlite::Error>> futures(units);
+            std::vector<std::thread> threads;
+            for (int id = 0; id < units; id++) {
+                threads.emplace_back([&group, &futures, id]() {
+                    futures[id] = group.submit([id](sqlite::Database &db) {
+                        sqlite::Statement statement(db, "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);");
+                        statement.bind(0, id);
+                        return sqlite::exec(statement);
+                    });
+                });
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            for (auto &future : futures) {
+                REQUIRE_FALSE(future.get());
+            }
+
+            REQUIRE(group.stats().units == units);
+            REQUIRE(group.stats().commits < units);
+        }
+
+        sqlite::Database db("test.db");
+        sqlite::Results results;
+        sqlite::exec(db, "SELECT * FROM Customers;", results);
+        REQUIRE(results.count() == units);
+    }
+
+    SECTION("It rolls back only the failing unit") {
+        { TestSetup setup; }
+        sqlite::Database db("test.db");
+
+        {
+            sqlite::GroupCommit group("test.db", std::chrono::milliseconds(10), 2);
+            std::future<sqlite::Error> good = group.submit([](sqlite::Database &db) {
+                return sqlite::exec(db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+            });
+            std::future<sqlite::Error> bad = group.submit([](sqlite::Database &db) {
+                return sqlite::exec(db, "INSERT INTO Missing VALUES (1);");
+            });
+            REQUIRE_FALSE(good.get());
+            REQUIRE(bad.get());
+        }
+
+        sqlite::Results results;
+        sqlite::exec(db, "SELECT * FROM Customers;", results);
+        REQUIRE(results.count() == 1);
+    }
+
+    SECTION("It returns errors that outlive the committer connection") {
+        { TestSetup setup; }
+        std::future<sqlite::Error> bad;
+
+        {
+            sqlite::GroupCommit group("test.db", std::chrono::milliseconds(10), 1);
+            bad = group.submit([](sqlite::Database &db) {
+                return sqlite::exec(db, "INSERT INTO Missing VALUES (1);");
+            });
+        }
+
+        REQUIRE(bad.get().msg() == "no such table: Missing");
+    }
+}
+
+TEST_CASE("Test AsyncWriter class") {
+    SECTION("It can write rows enqueued from many threads") {
+        { TestSetup setup; }
+        const int producers = 4, rows = 1000;
+
+        sqlite::AsyncWriter<int, std::string, int> writer("test.db", "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);",
+                                                          256, sqlite::OverflowPolicy::BLOCK, 100);
+        std::vector<std::thread> threads;
+        for (int producer = 0; producer < producers; producer++) {
+            threads.emplace_back([&writer, producer]() {
+                for (int id = 0; id < rows; id++) {
+                    writer.enqueue(producer * rows + id, "John", 29);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        REQUIRE_FALSE(writer.flush());
+
+        REQUIRE(writer.stats().depth == 0);
+        REQUIRE(writer.stats().written == producers * rows);
+        REQUIRE(writer.stats().dropped == 0);
+    }
+
+    SECTION("It can drop rows when the queue is full") {
+        TestSetup setup;
+        sqlite::AsyncWriter<int, std::string, int> writer("test.db", "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);",
+                                                          1, sqlite::OverflowPolicy::DROP, 1);
+
+        // Hold the writer back so the one-row queue fills up
+        sqlite::exec(setup.db, "BEGIN EXCLUSIVE;");
+        size_t dropped = 0;
+        for (int id = 0; id < 1000; id++) {
+            if (!writer.enqueue(id, "John", 29)) {
+                dropped++;
+            }
+        }
+        sqlite::exec(setup.db, "COMMIT;");
+        writer.flush();
+
+        REQUIRE(dropped > 0);
+        REQUIRE(writer.stats().dropped == dropped);
+        REQUIRE(writer.stats().written + dropped == 1000);
+    }
+}
+
+TEST_CASE("Test async exec") {
+    SECTION("It can run queries concurrently on a thread pool") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (2, 'Robert', 22);");
+
+        sqlite::QueryWorkerPool pool("test.db", 2);
+        std::future<sqlite::Results> john = sqlite::async_exec(pool, "SELECT * FROM Customers WHERE id = ?;", 1);
+        std::future<sqlite::Results> all = sqlite::async_exec(pool, "SELECT * FROM Customers;");
+
+        REQUIRE(john.get().get<std::string>("name") == "John");
+        REQUIRE(all.get().count() == 2);
+    }
+
+    SECTION("It can cancel a running query") {
+        { TestSetup setup; }
+        sqlite::QueryWorkerPool pool("test.db", 1);
+        sqlite::CancellationToken token;
+
+        // Long but finite, so a broken interrupt fails the test instead of hanging the suite
+        std::future<sqlite::Results> results = sqlite::async_exec(pool, token,
+            "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM n WHERE x < 200000000) SELECT count(*) FROM n;");
+
+        const auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!token.running() && std::chrono::steady_clock::now() < give_up) {
+            std::this_thread::yield();
+        }
+        REQUIRE(token.running());
+        token.cancel();
+
+        REQUIRE(token.cancelled());
+        try {
+            results.get();
+            FAIL("an interrupted query must not produce results");
+        }
+        catch (const sqlite::Exception &e) {
+            REQUIRE(e.error().code() == 9); // SQLITE_INTERRUPT
+        }
+    }
+
+    SECTION("It returns errors that outlive the worker connection") {
+        { TestSetup setup; }
+        std::future<sqlite::Results> results;
+        {
+            sqlite::QueryWorkerPool pool("test.db", 1);
+            results = sqlite::async_exec(pool, "SELECT * FROM Missing;");
+        }
+
+        try {
+            results.get();
+            FAIL("a failing query must not produce results");
+        }
+        catch (const sqlite::Exception &e) {
+            REQUIRE(e.error().msg() == "no such table: Missing");
+        }
+    }
+
+    SECTION("It can skip a query cancelled before it started") {
+        { TestSetup setup; }
+        sqlite::QueryWorkerPool pool("test.db", 1);
+        sqlite::CancellationToken token;
+        token.cancel();
+
+        std::future<sqlite::Results> results = sqlite::async_exec(pool, token, "SELECT * FROM Customers;");
+        try {
+            results.get();
+            FAIL("a cancelled query must not produce results");
+        }
+        catch (const sqlite::Exception &e) {
+            REQUIRE(e.error().code() == 9); // SQLITE_INTERRUPT
+        }
+    }
+}
+
+sqlite::Task count_customers(sqlite::EventLoop &loop, sqlite::Database &db, size_t &count) {
+    sqlite::Error err = sqlite::OK;
+    sqlite::Results results = co_await sqlite::query(loop, db, "SELECT * FROM Customers;", err);
+    count = err ? 0 : results.count();
+}
+
+sqlite::Task long_scan(sqlite::EventLoop &loop, sqlite::Database &db, bool &done) {
+    sqlite::Error err = sqlite::OK;
+    co_await sqlite::query(loop, db,
+        "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM n WHERE x < 5000000) SELECT count(*) FROM n;",
+        err, 1000);
+    done = true;
+}
+
+sqlite::Task ticker(sqlite::EventLoop &loop, const bool &done, size_t &ticks,
+                    std::chrono::nanoseconds &max_gap) {
+    struct Yield {
+        sqlite::EventLoop &loop;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { loop.post(handle); }
+        void await_resume() const noexcept {}
+    };
+
+    auto last = std::chrono::steady_clock::now();
+    while (!done) {
+        co_await Yield{ loop };
+        const auto now = std::chrono::steady_clock::now();
+        max_gap = std::max<std::chrono::nanoseconds>(max_gap, now - last);
+        last = now;
+        ticks++;
+    }
+}
+
+TEST_CASE("Test coroutine queries") {
+    SECTION("It can await a query") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+
+        sqlite::EventLoop loop;
+        size_t count = 0;
+        loop.spawn(count_customers(loop, setup.db, count));
+        loop.run();
+        REQUIRE(count == 1);
+    }
+
+    SECTION("It yields to other tasks during a long step") {
+        TestSetup setup;
+        sqlite::EventLoop loop;
+        bool done = false;
+        size_t ticks = 0;
+        std::chrono::nanoseconds max_gap{0};
+
+        loop.spawn(long_scan(loop, setup.db, done));
+        loop.spawn(ticker(loop, done, ticks, max_gap));
+        loop.run();
+
+        // 5M rows at one yield per 1000 instructions give the ticker thousands of turns;
+        // without yielding it would run at most once before the scan finishes
+        REQUIRE(done);
+        REQUIRE(ticks > 100);
+        // 1000 VM instructions take microseconds, so even a slow machine stays far below
+        // this bound, while a blocked loop would wait for the whole scan of 5M rows
+        REQUIRE(max_gap < std::chrono::milliseconds(250));
+    }
+}
+
+sqlite::Task endless_scan(sqlite::EventLoop &loop, sqlite::Database &db, sqlite::Error &err, bool &done) {
+    co_await sqlite::query(loop, db,
+        "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM n) SELECT count(*) FROM n;",
+        err, 1000, std::chrono::steady_clock::now() + std::chrono::milliseconds(50));
+    done = true;
+}
+
+TEST_CASE("Test deadlines") {
+    const std::string long_query =
+        "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM n) SELECT count(*) FROM n;";
+
+    SECTION("It stops an execution when its deadline expires") {
+        TestSetup setup;
+        const size_t fired = setup.db.deadlines_fired();
+
+        sqlite::Results results;
+        sqlite::Error err = sqlite::exec(setup.db, long_query, results,
+                                         std::chrono::steady_clock::now() + std::chrono::milliseconds(50));
+        REQUIRE(err.code() == sqlite::TIMEOUT.code());
+        REQUIRE(setup.db.deadlines_fired() == fired + 1);
+    }
+
+    SECTION("It can limit every execution of a statement") {
+        TestSetup setup;
+        sqlite::Statement statement(setup.db, long_query);
+        statement.set_timeout(std::chrono::milliseconds(50));
+
+        REQUIRE(sqlite::exec(statement).code() == sqlite::TIMEOUT.code());
+        REQUIRE(sqlite::exec(statement).code() == sqlite::TIMEOUT.code());
+    }
+
+    SECTION("It does not fire for a fast execution") {
+        TestSetup setup;
+        const size_t fired = setup.db.deadlines_fired();
+
+        REQUIRE_FALSE(sqlite::exec(setup.db, "SELECT * FROM Customers;",
+                                   std::chrono::steady_clock::now() + std::chrono::seconds(10)));
+        REQUIRE(setup.db.deadlines_fired() == fired);
+    }
+
+    SECTION("It can combine a deadline with a yielding query") {
+        TestSetup setup;
+        sqlite::EventLoop loop;
+        sqlite::Error err = sqlite::OK;
+        bool done = false;
+        size_t ticks = 0;
+        std::chrono::nanoseconds max_gap{0};
+
+        loop.spawn(endless_scan(loop, setup.db, err, done));
+        loop.spawn(ticker(loop, done, ticks, max_gap));
+        loop.run();
+
+        // The deadline fired and the ticker kept running while the query yielded
+        REQUIRE(err.code() == sqlite::TIMEOUT.code());
+        REQUIRE(ticks > 1);
+    }
+}
+
+TEST_CASE("Test busy handling") {
+    SECTION("It fails immediately on a locked database") {
+        TestSetup setup;
+        sqlite::Database other("test.db");
+        other.set_busy_strategy(sqlite::BusyStrategy::fail());
+
+        // Write-write conflicts are serialized in every journal mode
+        sqlite::exec(setup.db, "BEGIN EXCLUSIVE;");
+        REQUIRE(sqlite::exec(other, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);"));
+        sqlite::exec(setup.db, "COMMIT;");
+    }
+
+    SECTION("It records lock waits with backoff") {
+        TestSetup setup;
+        sqlite::Database other("test.db");
+        other.set_busy_strategy(sqlite::BusyStrategy::backoff(std::chrono::microseconds(100), std::chrono::milliseconds(5),
+                                                              std::chrono::seconds(5), 0.5));
+        REQUIRE(other.busy_waits().percentile(0.99) == std::chrono::nanoseconds(0));
+
+        sqlite::exec(setup.db, "BEGIN EXCLUSIVE;");
+        std::thread writer([&setup]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            sqlite::exec(setup.db, "COMMIT;");
+        });
+        REQUIRE_FALSE(sqlite::exec(other, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);"));
+        writer.join();
+
+        REQUIRE(other.busy_waits().count() == 1);
+        REQUIRE(other.busy_waits().total() >= std::chrono::milliseconds(10));
+        REQUIRE(other.busy_waits().percentile(1.0) >= std::chrono::milliseconds(10));
+    }
+
+    SECTION("It retries a transaction body") {
+        TestSetup setup;
+        sqlite::Database other("test.db");
+        other.set_busy_strategy(sqlite::BusyStrategy::timeout(std::chrono::milliseconds(1)));
+
+        sqlite::exec(setup.db, "BEGIN EXCLUSIVE;");
+        std::thread writer([&setup]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            sqlite::exec(setup.db, "COMMIT;");
+        });
+
+        size_t attempts = 0;
+        sqlite::Error err = sqlite::retry_transaction(other, [&attempts](sqlite::Database &db) {
+            attempts++;
+            return sqlite::exec(db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+        }, 1000);
+        writer.join();
+
+        REQUIRE_FALSE(err);
+        REQUIRE(attempts > 1);
+    }
+}
+
+TEST_CASE("Test Error class") {
+    static_assert(std::is_trivially_copyable_v<sqlite::Error>);
+    static_assert(!sqlite::OK);
+    static_assert(noexcept(sqlite::exec(std::declval<sqlite::Database &>(), std::declval<const std::string &>())));
+    static_assert(noexcept(sqlite::exec(std::declval<sqlite::Statement &>())));
+
+    SECTION("It does not allocate on failure until the message is asked for") {
+        TestSetup setup;
+        const std::string sql = "DELETE FROM Missing;";
+
+        const size_t before = allocations;
+        sqlite::Error err = sqlite::exec(setup.db, sql);
+        sqlite::Error copy = err;
+        const size_t after = allocations;
+        REQUIRE(after == before);
+        REQUIRE(copy);
+    }
+
+    SECTION("It keeps the connection's message") {
+        TestSetup setup;
+        sqlite::Error err = sqlite::exec(setup.db, "DELETE FROM Missing;");
+        REQUIRE(err.msg() == "no such table: Missing");
+    }
+
+    SECTION("It keeps its message after the connection fails again with the same code") {
+        TestSetup setup;
+        sqlite::Error err = sqlite::exec(setup.db, "DELETE FROM Missing;");
+        sqlite::Error later = sqlite::exec(setup.db, "SELEC 1;");
+
+        REQUIRE(err.code() == later.code());
+        REQUIRE(err.msg() == "no such table: Missing");
+        REQUIRE(later.msg() != err.msg());
+    }
+
+    SECTION("It keeps its message after the connection is closed") {
+        sqlite::Error err = sqlite::OK;
+        {
+            TestSetup setup;
+            err = sqlite::exec(setup.db, "DELETE FROM Missing;");
+        }
+        REQUIRE(err.msg() == "no such table: Missing");
+    }
+
+    SECTION("It builds a message from the error code") {
+        sqlite::Error err(1);
+        REQUIRE(err);
+        REQUIRE(err.code() == 1);
+        REQUIRE_FALSE(err.msg().empty());
+    }
+}
+
+TEST_CASE("Test move semantics") {
+    static_assert(!std::is_copy_constructible_v<sqlite::Database>);
+    static_assert(!std::is_copy_constructible_v<sqlite::Statement>);
+    static_assert(!std::is_copy_constructible_v<sqlite::Transaction>);
+    static_assert(!std::is_copy_constructible_v<sqlite::Results>);
+    static_assert(std::is_nothrow_move_constructible_v<sqlite::Database>);
+    static_assert(std::is_nothrow_move_constructible_v<sqlite::Statement>);
+    static_assert(std::is_nothrow_move_constructible_v<sqlite::Transaction>);
+    static_assert(std::is_nothrow_move_constructible_v<sqlite::Results>);
+
+    SECTION("It can return results by value") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+
+        sqlite::Error err = sqlite::OK;
+        sqlite::Results results = sqlite::exec(setup.db, "SELECT * FROM Customers;", err);
+        REQUIRE_FALSE(err);
+        REQUIRE(results.count() == 1);
+    }
+
+    SECTION("It does not allocate when executing a statement without results") {
+        TestSetup setup;
+        const std::string sql = "DELETE FROM Customers;";
+        sqlite::exec(setup.db, sql); // warm up the statement cache
+
+        const size_t before = allocations;
+        sqlite::exec(setup.db, sql);
+        const size_t after = allocations;
+        REQUIRE(after == before);
+    }
+}
+
+TEST_CASE("Test Results class") {
+    static_assert(std::ranges::input_range<sqlite::Results>);
+
+    SECTION("It can stream rows one by one") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (2, 'Robert', 22);");
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (3, 'David', 22);");
+
+        sqlite::Results results(sqlite::Results::Mode::STREAMING);
+        sqlite::exec(setup.db, "SELECT id FROM Customers ORDER BY id;", results);
+
+        int expected_id = 1;
+        for (auto &row : results) {
+            REQUIRE(row.get<int>("id") == expected_id++);
+        }
+        REQUIRE(expected_id == 4);
+    }
+
+    SECTION("It can stream rows returned by value in a range-for") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (2, 'Robert', 22);");
+
+        sqlite::Error err = sqlite::OK;
+        int expected_id = 1;
+        for (auto &row : sqlite::exec(setup.db, "SELECT id FROM Customers ORDER BY id;", err,
+                                      sqlite::Results::Mode::STREAMING)) {
+            REQUIRE(row.get<int>("id") == expected_id++);
+        }
+        REQUIRE_FALSE(err);
+        REQUIRE(expected_id == 3);
+    }
+
+    SECTION("It reports a step error part-way through a streaming scan") {
+        TestSetup setup;
+        for (int id = 1; id <= 5; id++) {
+            sqlite::Statement statement(setup.db, "INSERT INTO Customers (id, name, age) VALUES (?, 'John', 31);");
+            statement.bind(0, id);
+            sqlite::exec(statement);
+        }
+
+        // abs() of the smallest integer fails with "integer overflow" on the third row
+        sqlite::Results results(sqlite::Results::Mode::STREAMING);
+        REQUIRE_FALSE(sqlite::exec(setup.db,
+            "SELECT id, CASE WHEN id = 3 THEN abs(-9223372036854775807 - 1) ELSE id END AS value "
+            "FROM Customers;", results)); // rowid order, so the error comes from a later step
+
+        int rows = 0;
+        for (auto &row : results) {
+            REQUIRE(row.get<int>("id") == ++rows);
+        }
+        REQUIRE(rows == 2);
+        REQUIRE(results.error());
+        REQUIRE(results.error().msg() == "integer overflow");
+    }
+
+    SECTION("It can prefetch rows on a helper thread") {
+        TestSetup setup;
+        for (int id = 1; id <= 100; id++) {
+            sqlite::Statement statement(setup.db, "INSERT INTO Customers (id, name, age) VALUES (?, 'John', 31);");
+            statement.bind(0, id);
+            sqlite::exec(statement);
+        }
+
+        sqlite::Results results(sqlite::Results::Mode::PREFETCH, 8);
+        sqlite::exec(setup.db, "SELECT id FROM Customers ORDER BY id;", results);
+
+        int expected_id = 1;
+        for (auto &row : results) {
+            REQUIRE(row.get<int>("id") == expected_id++);
+        }
+        REQUIRE(expected_id == 101);
+    }
+
+    SECTION("It can access text without copying while streaming") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (2, x'0102', 22);");
+
+        sqlite::Results results(sqlite::Results::Mode::STREAMING);
+        sqlite::exec(setup.db, "SELECT name FROM Customers ORDER BY id;", results);
+
+        auto it = results.begin();
+        REQUIRE(it->get<std::string_view>("name") == "John");
+        ++it;
+        std::span<const std::byte> name = it->get<std::span<const std::byte>>("name");
+        REQUIRE(name.size() == 2);
+        REQUIRE(name[0] == std::byte{0x01});
+    }
+
+    SECTION("It can access text as a view") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT name FROM Customers;", results);
+
+        std::string_view name = results.get<std::string_view>("name");
+        REQUIRE(name == "John");
+    }
+
+    SECTION("It can access blobs as a view") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, x'0102', 31);");
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT name FROM Customers;", results);
+
+        std::span<const std::byte> name = results.get<std::span<const std::byte>>("name");
+        REQUIRE(name.size() == 2);
+        REQUIRE(name[0] == std::byte{0x01});
+        REQUIRE(name[1] == std::byte{0x02});
+    }
+
+    SECTION("It can access columns by name, index and compile-time name") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT id, name, age FROM Customers;", results);
+
+        const std::string column_name = "name";
+        REQUIRE(results.get<std::string>(column_name) == "John");
+        REQUIRE(results.get<std::string>(std::string_view("name")) == "John");
+        REQUIRE(results.get<std::string>(1) == "John");
+        REQUIRE(results.get<"name", std::string>() == "John");
+
+        for (auto &row : results) {
+            REQUIRE(row.get<"age", int>() == 31);
+            REQUIRE(row.get<int>(2) == 31);
+        }
+    }
+
+    SECTION("It resolves duplicate column names to the leftmost column") {
+        TestSetup setup;
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT 1 AS id, 2 AS id, 3 AS Age;", results);
+
+        REQUIRE(results.get<int>("id") == 1);
+        REQUIRE(results.get<"id", int>() == 1);
+        REQUIRE(results.get<int>("Age") == 3);
+        REQUIRE(results.get<int>("age") == NULL); // names are case-sensitive
+    }
+
+    SECTION("It buffers rows by default") {
+        sqlite::Results results;
+        REQUIRE(results.mode() == sqlite::Results::Mode::BUFFERED);
+    }
+}
+
+TEST_CASE("Test TypedResults class") {
+    static_assert(std::ranges::input_range<sqlite::TypedResults<int, std::string, int>>);
+    static_assert(std::is_same_v<sqlite::TypedResults<Customer>::row_type, Customer>);
+    static_assert(std::is_same_v<sqlite::TypedResults<int>::row_type, std::tuple<int>>);
+
+    SECTION("It can decode rows into tuples") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (2, 'Robert', 22);");
+
+        sqlite::TypedResults<int, std::string, int> results;
+        REQUIRE_FALSE(sqlite::exec(setup.db, "SELECT id, name, age FROM Customers ORDER BY id;", results));
+        REQUIRE(results.count() == 2);
+
+        int expected_id = 1;
+        for (const auto &[id, name, age] : results) {
+            REQUIRE(id == expected_id++);
+        }
+        REQUIRE(std::get<1>(results.get(0)) == "John");
+    }
+
+    SECTION("It can decode rows into aggregates") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+
+        sqlite::TypedResults<Customer> results;
+        REQUIRE_FALSE(sqlite::exec(setup.db, "SELECT id, name, age FROM Customers;", results));
+        REQUIRE(results.get(0).name == "John");
+        REQUIRE(results.get(0).age == 31);
+    }
+
+    SECTION("It cannot decode rows with a mismatched column count") {
+        TestSetup setup;
+        sqlite::TypedResults<int, std::string> results;
+        REQUIRE(sqlite::exec(setup.db, "SELECT id, name, age FROM Customers;", results));
+    }
+}
+
+TEST_CASE("Test ColumnBatch class") {
+    SECTION("It can fetch rows into column buffers in batches") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (2, 'Robert', 22);");
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (3, 'David', 22);");
+
+        sqlite::Statement statement(setup.db, "SELECT id, age FROM Customers ORDER BY id;");
+        sqlite::ColumnBatch batch(statement, 2);
+        std::vector<int64_t> ids;
+        std::vector<double> ages;
+        batch.bind_column(0, ids);
+        batch.bind_column(1, ages);
+
+        size_t rows_fetched = 0;
+        REQUIRE_FALSE(batch.fetch(rows_fetched));
+        REQUIRE(rows_fetched == 2);
+        REQUIRE(ids[0] == 1);
+        REQUIRE(ids[1] == 2);
+        REQUIRE(ages[0] == 31);
+
+        REQUIRE_FALSE(batch.fetch(rows_fetched));
+        REQUIRE(rows_fetched == 1);
+        REQUIRE(ids[0] == 3);
+        REQUIRE(ages[0] == 22);
+
+        REQUIRE_FALSE(batch.fetch(rows_fetched));
+        REQUIRE(rows_fetched == 0);
+    }
+
+    SECTION("It can tell NULL apart from zero with a null indicator") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 0);");
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (2, 'Robert', NULL);");
+
+        sqlite::Statement statement(setup.db, "SELECT age FROM Customers ORDER BY id;");
+        sqlite::ColumnBatch batch(statement, 2);
+        std::vector<int64_t> ages;
+        std::vector<uint8_t> age_is_null;
+        batch.bind_column(0, ages, age_is_null);
+
+        size_t rows_fetched = 0;
+        REQUIRE_FALSE(batch.fetch(rows_fetched));
+        REQUIRE(rows_fetched == 2);
+        REQUIRE(ages[0] == 0);
+        REQUIRE(age_is_null[0] == 0);
+        REQUIRE(ages[1] == 0);
+        REQUIRE(age_is_null[1] == 1);
+    }
+
+    SECTION("It reuses column buffers between fetches") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (2, 'Robert', 22);");
+
+        sqlite::Statement statement(setup.db, "SELECT id FROM Customers ORDER BY id;");
+        sqlite::ColumnBatch batch(statement, 1);
+        std::vector<int64_t> ids;
+        batch.bind_column(0, ids);
+
+        size_t rows_fetched = 0;
+        batch.fetch(rows_fetched);
+        const int64_t *data = ids.data();
+        batch.fetch(rows_fetched);
+        REQUIRE(ids.data() == data);
+        REQUIRE(ids.size() == batch.capacity());
+    }
+}
+
+TEST_CASE("Test StatementCache class") {
+    SECTION("It reuses a prepared statement for the same SQL text") {
+        TestSetup setup;
+        const std::string sql = "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 29);";
+        setup.db.statement_cache().clear();
+
+        sqlite::exec(setup.db, sql);
+        sqlite::exec(setup.db, sql);
+
+        REQUIRE(setup.db.statement_cache().size() == 1);
+        REQUIRE(setup.db.statement_cache().stats().misses == 1);
+        REQUIRE(setup.db.statement_cache().stats().hits == 1);
+    }
+
+    SECTION("It evicts the least recently used statement") {
+        TestSetup setup;
+        setup.db.statement_cache().clear();
+        setup.db.statement_cache().resize(1);
+
+        sqlite::exec(setup.db, "SELECT * FROM Customers;");
+        sqlite::exec(setup.db, "SELECT name FROM Customers;");
+
+        REQUIRE(setup.db.statement_cache().size() == 1);
+        REQUIRE(setup.db.statement_cache().stats().evictions == 1);
+    }
+
+    SECTION("It prepares a separate statement for SQL that is already checked out") {
+        TestSetup setup;
+        const std::string sql = "SELECT * FROM Customers;";
+        setup.db.statement_cache().clear();
+
+        {
+            sqlite::Statement outer(setup.db, sql);
+            sqlite::Statement inner(setup.db, sql);
+            REQUIRE_FALSE(sqlite::exec(inner));
+            REQUIRE_FALSE(sqlite::exec(outer));
+        }
+
+        REQUIRE(setup.db.statement_cache().size() == 1);
+        REQUIRE(setup.db.statement_cache().stats().misses == 2);
+    }
+
+    SECTION("It caches nothing with a capacity of 0") {
+        TestSetup setup;
+        REQUIRE(setup.db.statement_cache().capacity() == sqlite::StatementCache::DEFAULT_CAPACITY);
+        setup.db.statement_cache().resize(0);
+
+        sqlite::exec(setup.db, "SELECT * FROM Customers;");
+        sqlite::exec(setup.db, "SELECT * FROM Customers;");
+
+        REQUIRE(setup.db.statement_cache().size() == 0);
+        REQUIRE(setup.db.statement_cache().stats().hits == 0);
+    }
+
+    SECTION("It resets a statement when it is checked back in") {
+        TestSetup setup;
+        const std::string sql = "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);";
+
+        {
+            sqlite::Statement statement(setup.db, sql);
+            statement.bind(0, 1);
+            statement.bind(1, std::string("John"));
+            sqlite::exec(statement);
+        }
+
+        {
+            // Bindings from the previous checkout are cleared
+            sqlite::Statement statement(setup.db, sql);
+            sqlite::exec(statement);
+        }
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers WHERE name IS NULL;", results);
+        REQUIRE(results.count() == 1);
+    }
+}
+
+TEST_CASE("Benchmark Statement reuse", "[.][benchmark]") {
+    const int rows = 1000000;
+
+    BENCHMARK("Re-preparing a statement for each insert") {
+        TestSetup setup;
+        setup.db.statement_cache().resize(0); // force a real prepare per insert
+        sqlite::Transaction tx(setup.db);
+        for (int id = 0; id < rows; id++) {
+            sqlite::Statement statement(setup.db, "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);");
+            statement.bind(0, id);
+            statement.bind(1, std::string("John"));
+            statement.bind(2, 29);
+            sqlite::exec(statement);
+        }
+        return tx.commit();
+    };
+
+    BENCHMARK("Reusing one prepared statement for all inserts") {
+        TestSetup setup;
+        sqlite::Transaction tx(setup.db);
+        sqlite::Statement statement(setup.db, "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);");
+        for (int id = 0; id < rows; id++) {
+            statement.bind(0, id);
+            statement.bind(1, std::string("John"));
+            statement.bind(2, 29);
+            sqlite::exec(statement);
+        }
+        return tx.commit();
+    };
+}
+
+TEST_CASE("Benchmark multi-row insert", "[.][benchmark]") {
+    std::vector<std::tuple<int, std::string, int>> rows;
+    for (int id = 0; id < 1000000; id++) {
+        rows.emplace_back(id, "John", 29);
+    }
+
+    BENCHMARK("Single-row insert") {
+        TestSetup setup;
+        sqlite::Statement statement(setup.db, "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);");
+        return statement.exec_batch(rows);
+    };
+
+    BENCHMARK("Multi-row insert") {
+        TestSetup setup;
+        sqlite::MultiRowInsert insert(setup.db, "Customers", { "id", "name", "age" });
+        return insert.exec(rows);
+    };
+}
+
+TEST_CASE("Benchmark prefetching scan", "[.][benchmark]") {
+    // About 200 MB of rows, far larger than the 2 MB page cache each scan gets below,
+    // so every scan keeps reading pages from the file while the consumer works
+    {
+        TestSetup setup;
+        std::vector<std::tuple<int, std::string, int>> rows;
+        for (int id = 0; id < 200000; id++) {
+            rows.emplace_back(id, std::string(1000, 'x'), id % 100);
+        }
+        sqlite::Statement statement(setup.db, "INSERT INTO Customers (id, name, age) VALUES (?, ?, ?);");
+        statement.exec_batch(rows);
+    }
+
+    // Per-row CPU work comparable to one sqlite3_step on a cold page
+    auto consume = [](const sqlite::Results &results) {
+        size_t hash = 0;
+        for (auto &row : results) {
+            for (char c : row.get<std::string_view>("name")) {
+                hash = hash * 31 + c;
+            }
+        }
+        return hash;
+    };
+
+    // Scans in rowid order, so every step reads its rows from the table pages instead of
+    // a sorter filled during the first step
+    BENCHMARK("Streaming scan") {
+        sqlite::Database db("test.db");
+        sqlite::exec(db, "PRAGMA cache_size = -2000;");
+        sqlite::Results results(sqlite::Results::Mode::STREAMING);
+        sqlite::exec(db, "SELECT name FROM Customers;", results);
+        return consume(results);
+    };
+
+    BENCHMARK("Prefetching scan") {
+        sqlite::Database db("test.db");
+        sqlite::exec(db, "PRAGMA cache_size = -2000;");
+        sqlite::Results results(sqlite::Results::Mode::PREFETCH, 256);
+        sqlite::exec(db, "SELECT name FROM Customers;", results);
+        return consume(results);
+    };
+}
+
+TEST_CASE("Test ResultCache class") {
+    SECTION("It is disabled by default") {
+        TestSetup setup;
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+
+        REQUIRE(setup.db.result_cache().capacity() == 0);
+        REQUIRE(setup.db.result_cache().stats().hits == 0);
+    }
+
+    SECTION("It returns cached results for the same SQL and bound values") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+        setup.db.result_cache().resize(1 << 20);
+
+        for (int i = 0; i < 2; i++) {
+            sqlite::Statement statement(setup.db, "SELECT name FROM Customers WHERE id = ?;");
+            statement.bind(0, 1);
+            sqlite::Results results;
+            sqlite::exec(statement, results);
+            REQUIRE(results.get<std::string>("name") == "John");
+        }
+
+        sqlite::Statement statement(setup.db, "SELECT name FROM Customers WHERE id = ?;");
+        statement.bind(0, 2);
+        sqlite::Results results;
+        sqlite::exec(statement, results);
+        REQUIRE(results.count() == 0);
+
+        REQUIRE(setup.db.result_cache().stats().hits == 1);
+        REQUIRE(setup.db.result_cache().stats().misses == 2);
+        REQUIRE(setup.db.result_cache().memory() > 0);
+    }
+
+    SECTION("It is invalidated by writes on the same connection") {
+        TestSetup setup;
+        setup.db.result_cache().resize(1 << 20);
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+
+        REQUIRE(results.count() == 1);
+        REQUIRE(setup.db.result_cache().stats().invalidations == 1);
+    }
+
+    SECTION("It is invalidated by a truncating delete on the same connection") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+        setup.db.result_cache().resize(1 << 20);
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+        sqlite::exec(setup.db, "DELETE FROM Customers;");
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+
+        REQUIRE(results.count() == 0);
+        REQUIRE(setup.db.result_cache().stats().invalidations == 1);
+    }
+
+    SECTION("It is invalidated by writes from another connection") {
+        TestSetup setup;
+        sqlite::Database other("test.db");
+        setup.db.result_cache().resize(1 << 20);
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+        sqlite::exec(other, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+
+        REQUIRE(results.count() == 1);
+        REQUIRE(setup.db.result_cache().stats().invalidations == 1);
+    }
+
+    SECTION("It does not cache non-deterministic statements") {
+        TestSetup setup;
+        setup.db.result_cache().resize(1 << 20);
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT random() AS value;", results);
+        sqlite::exec(setup.db, "SELECT random() AS value;", results);
+
+        REQUIRE(setup.db.result_cache().stats().hits == 0);
+        REQUIRE(setup.db.result_cache().memory() == 0);
+    }
+
+    SECTION("It does not cache statements that opted out") {
+        TestSetup setup;
+        setup.db.result_cache().resize(1 << 20);
+
+        for (int i = 0; i < 2; i++) {
+            sqlite::Statement statement(setup.db, "SELECT * FROM Customers;");
+            statement.set_cacheable(false);
+            sqlite::Results results;
+            sqlite::exec(statement, results);
+        }
+
+        REQUIRE(setup.db.result_cache().stats().hits == 0);
+    }
+
+    SECTION("It stays within its memory bound") {
+        TestSetup setup;
+        sqlite::exec(setup.db, "INSERT INTO Customers (id, name, age) VALUES (1, 'John', 31);");
+        setup.db.result_cache().resize(1);
+
+        sqlite::Results results;
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+        sqlite::exec(setup.db, "SELECT * FROM Customers;", results);
+
+        REQUIRE(setup.db.result_cache().memory() <= setup.db.result_cache().capacity());
+        REQUIRE(setup.db.result_cache().stats().hits == 0);
+    }
 }